@@ -34,30 +34,89 @@
 
     static struct _bcm_pin_map _p1[] = {
         // P1-1 - P1-2
-        {  1, 255,  -1, NULL, NULL }, {  2, 255,  -1, NULL, NULL },
-        {  3,   2,  -1, NULL, NULL }, {  4, 255,  -1, NULL, NULL },
-        {  5,   3,  -1, NULL, NULL }, {  6, 255,  -1, NULL, NULL },
-        {  7,   4,  -1, NULL, NULL }, {  8,  14,  -1, NULL, NULL },
-        {  9, 255,  -1, NULL, NULL }, { 10,  15,  -1, NULL, NULL },
-        { 11,  17,  -1, NULL, NULL }, { 12,  18,  -1, NULL, NULL },
-        { 13,  27,  -1, NULL, NULL }, { 14, 255,  -1, NULL, NULL },
-        { 15,  22,  -1, NULL, NULL }, { 16,  23,  -1, NULL, NULL },
-        { 17, 255,  -1, NULL, NULL }, { 18,  24,  -1, NULL, NULL },
-        { 19,  10,  -1, NULL, NULL }, { 20, 255,  -1, NULL, NULL },
-        { 21,   9,  -1, NULL, NULL }, { 22,  25,  -1, NULL, NULL },
-        { 23,  11,  -1, NULL, NULL }, { 24,   8,  -1, NULL, NULL },
-        { 25, 255,  -1, NULL, NULL }, { 26,   7,  -1, NULL, NULL },
-        { 27,   0,  -1, NULL, NULL }, { 28,   1,  -1, NULL, NULL },
-        { 29,   5,  -1, NULL, NULL }, { 30, 255,  -1, NULL, NULL },
-        { 31,   6,  -1, NULL, NULL }, { 32,  12,  -1, NULL, NULL },
-        { 33,  13,  -1, NULL, NULL }, { 34, 255,  -1, NULL, NULL },
-        { 35,  19,  -1, NULL, NULL }, { 36,  16,  -1, NULL, NULL },
-        { 37,  26,  -1, NULL, NULL }, { 38,  20,  -1, NULL, NULL },
+        {  1, 255,  -1, NULL }, {  2, 255,  -1, NULL },
+        {  3,   2,  -1, NULL }, {  4, 255,  -1, NULL },
+        {  5,   3,  -1, NULL }, {  6, 255,  -1, NULL },
+        {  7,   4,  -1, NULL }, {  8,  14,  -1, NULL },
+        {  9, 255,  -1, NULL }, { 10,  15,  -1, NULL },
+        { 11,  17,  -1, NULL }, { 12,  18,  -1, NULL },
+        { 13,  27,  -1, NULL }, { 14, 255,  -1, NULL },
+        { 15,  22,  -1, NULL }, { 16,  23,  -1, NULL },
+        { 17, 255,  -1, NULL }, { 18,  24,  -1, NULL },
+        { 19,  10,  -1, NULL }, { 20, 255,  -1, NULL },
+        { 21,   9,  -1, NULL }, { 22,  25,  -1, NULL },
+        { 23,  11,  -1, NULL }, { 24,   8,  -1, NULL },
+        { 25, 255,  -1, NULL }, { 26,   7,  -1, NULL },
+        { 27,   0,  -1, NULL }, { 28,   1,  -1, NULL },
+        { 29,   5,  -1, NULL }, { 30, 255,  -1, NULL },
+        { 31,   6,  -1, NULL }, { 32,  12,  -1, NULL },
+        { 33,  13,  -1, NULL }, { 34, 255,  -1, NULL },
+        { 35,  19,  -1, NULL }, { 36,  16,  -1, NULL },
+        { 37,  26,  -1, NULL }, { 38,  20,  -1, NULL },
         // P1-39 - P1-40
-        { 39, 255,  -1, NULL, NULL }, { 40,  21 , -1, NULL, NULL }
+        { 39, 255,  -1, NULL }, { 40,  21 , -1, NULL }
     };
  
 
+// ==========================================================================
+// --------------------      event recorder state        --------------------
+// ==========================================================================
+
+    // the ring file is mapped once in recorderStart(). Event threads only
+    // touch the mapping, so recording does not need any syscall or
+    // allocation per event. _recorderWriters counts the threads that
+    // currently write to the mapping, recorderStop() waits for them to
+    // leave before the file is unmapped.
+    // recorderStart() and recorderStop() are serialized by _recorderLock,
+    // so two starts can't both map a file.
+    static struct _event_log_header* _pRecorder = NULL;
+    static size_t _recorderSize = 0;
+    static int _recorderWriters = 0;
+    static pthread_mutex_t _recorderLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// ==========================================================================
+// --------------------         handler pool             --------------------
+// ==========================================================================
+
+    // handler records, one for each entry of the map table. Installing
+    // or clearing a handler only hands out/returns the record of the
+    // pin, so nothing is allocated and nothing can leak.
+    static struct _event_thread_arg _handler[40];
+    static pthread_once_t _handlerPoolOnce = PTHREAD_ONCE_INIT;
+
+
+static int handlerStop( int mapEntry );
+
+
+// **************************************************************************
+// static void handlerPoolInit( void )
+// -----------------------------------------------------------------
+//
+// initialize the handler records once, before the first use
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+static void handlerPoolInit( void )
+{
+    int i;
+
+    for( i = 0; i < 40; i++ )
+    {
+        _handler[i].linefd = -1;
+        _handler[i].wakefd = -1;
+        pthread_mutex_init( &_handler[i].lock, NULL );
+    }
+}
+
+
 // **************************************************************************
 // static int mapFindBCM( uint8_t gpio )
 // -----------------------------------------------------------------
@@ -155,11 +214,13 @@ int pinLock( uint8_t pin, int mode )
                         {
                             _p1[mapEntry].fd = req.fd;
                             close(devfd);
+                            free( chrdev_name );
                             retVal = DSGPIO_ERROR_NO_ERROR;
                         }
                     }
                     else
                     {
+                        free( chrdev_name );
                         retVal = DSGPIO_ERROR_OPEN_DEVICE;
                     }
                 }
@@ -182,7 +243,8 @@ int pinLock( uint8_t pin, int mode )
 // int pinRelease( uint8_t pin )
 // -----------------------------------------------------------------
 //
-// release a specific GPIO by simply close its handle
+// release a specific GPIO by simply close its handle. An event
+// handler installed on the GPIO is stopped first.
 //
 // -----------------------------------------------------------------
 //
@@ -206,13 +268,19 @@ int pinRelease( uint8_t pin )
         }
         else
         {
+            // the event thread must not poll a closed line
+            if( _p1[mapEntry].pArgs != NULL &&
+                (retVal = handlerStop( mapEntry )) != DSGPIO_ERROR_NO_ERROR )
+            {
+                return( retVal );
+            }
+
             if( close(_p1[mapEntry].fd) < 0 )
             {
                 retVal = DSGPIO_ERROR_PIN_RELEASE;
             }
             else
             {
-                close( _p1[mapEntry].fd );
                 retVal = DSGPIO_ERROR_NO_ERROR;
             }
 
@@ -308,8 +376,6 @@ int pinState( uint8_t pin, uint8_t action, int state )
                     }
                     else
                     {
-printf("data: %d\n", data.values[0]);
-
                         if( data.values[0] > 0 )
                         {
                             retVal = DSGPIO_PIN_STATE_HIGH;
@@ -329,18 +395,134 @@ printf("data: %d\n", data.values[0]);
 
 
 
+// **************************************************************************
+// int pinHandle( uint8_t pin )
+// -----------------------------------------------------------------
+//
+// return the line handle of a locked GPIO, so callers that cache
+// it (e.g. the C++ wrapper) can do the ioctl directly
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin    bcm no of pin
+//
+// -----------------------------------------------------------------
+//
+// line handle on success, otherwise an error code
+//
+// **************************************************************************
+int pinHandle( uint8_t pin )
+{
+    int retVal = 0;
+    int mapEntry;
+
+    if( (mapEntry = retVal = mapFindBCM( pin )) >= 0 )
+    {
+        if( _p1[mapEntry].fd < 0 )
+        {
+            retVal = DSGPIO_ERROR_PIN_NOT_LOCKED;
+        }
+        else
+        {
+            retVal = _p1[mapEntry].fd;
+        }
+    }
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// void recorderWrite( uint8_t pin, struct gpioevent_data* event )
+// -----------------------------------------------------------------
+//
+// append an event to the ring file, if the recorder is running.
+// The slot is claimed by an atomic increment of the record counter,
+// so several event threads may record at the same time. The
+// sequence no of the slot is written last, so replay can skip
+// slots that were claimed, but never completely written.
+// Called by the event threads, may be used to record synthetic
+// events, too.
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin                  bcm no of pin
+// struct gpioevent_data* event event as read from the line
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+void recorderWrite( uint8_t pin, struct gpioevent_data* event )
+{
+    struct _event_log_header* pLog;
+    struct _event_record* pRecord;
+    uint64_t index;
+
+    __atomic_add_fetch( &_recorderWriters, 1, __ATOMIC_SEQ_CST );
+
+    if( (pLog = __atomic_load_n( &_pRecorder, __ATOMIC_SEQ_CST )) != NULL )
+    {
+        index = __atomic_fetch_add( &pLog->count, 1, __ATOMIC_RELAXED );
+        pRecord = (struct _event_record*) (pLog + 1) + 
+                      (index % pLog->capacity);
+
+        __atomic_store_n( &pRecord->seq, 0, __ATOMIC_RELAXED );
+        pRecord->timestamp = event->timestamp;
+        pRecord->id = event->id;
+        pRecord->pin = pin;
+        __atomic_store_n( &pRecord->seq, (uint32_t) (index + 1), 
+                          __ATOMIC_RELEASE );
+    }
+
+    __atomic_sub_fetch( &_recorderWriters, 1, __ATOMIC_SEQ_CST );
+}
+
+
+// **************************************************************************
+// static void dispatchEvent( struct _event_thread_arg* pData, 
+//                            struct gpioevent_data* event )
+// -----------------------------------------------------------------
+//
+// call the handler function, if the event matches the event flags
+// of the handler. Used by the event threads and the replay driver,
+// the caller holds the lock of the handler record
+//
+// -----------------------------------------------------------------
+//
+// struct _event_thread_arg* pData handler related information
+// struct gpioevent_data* event    event to deliver
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+static void dispatchEvent( struct _event_thread_arg* pData, 
+                           struct gpioevent_data* event )
+{
+    if( (event->id & pData->eventFlags) && pData->callBack != NULL )
+    {
+        pData->callBack( pData->pin, event, pData->pUserData );
+    }
+}
+
+
 // **************************************************************************
 // static void* eventThread( void* pArg )
 // -----------------------------------------------------------------
 //
 // a thread that is created for each event handler. It checks for
 // the occurrance of the specified event(s) and calls the handler
-// function
+// function. The thread waits for the line and its wakeup eventfd
+// at the same time and terminates, as soon as the eventfd is
+// signaled. So it never is cancelled inside a callback.
 //
 // -----------------------------------------------------------------
 //
-// void* pArg     pointer to thread related information. At this 
-//                time this is stored in the map table, too.
+// void* pArg     pointer to the handler record of the pin. The
+//                record is owned by the handler pool.
 //
 // -----------------------------------------------------------------
 //
@@ -351,35 +533,45 @@ static void* eventThread( void* pArg )
 {
     struct _event_thread_arg* pData;
     struct gpioevent_data event;
-    static uint64_t lastTimestamp = 0;
+    struct pollfd fds[2];
 
     if( (pData = (struct _event_thread_arg*) pArg) != NULL )
     {
-fprintf(stdout, "eventThread: pData != NULL\n");
+        fds[0].fd = pData->linefd;
+        fds[0].events = POLLIN;
+        fds[1].fd = pData->wakefd;
+        fds[1].events = POLLIN;
+
         while( 1 )
         {
-fprintf(stdout, "eventThread: check for event\n");
-            if( read(pData->linefd, &event, sizeof(event)) > 0 )
+            if( poll( fds, 2, -1 ) < 0 )
             {
-fprintf(stdout, " timestamp %" PRIu64, event.timestamp);
-fprintf(stdout, " diff %" PRIu64 " ", event.timestamp - lastTimestamp);
-lastTimestamp = event.timestamp;
+                if( errno == EINTR )
+                {
+                    continue;
+                }
+                break;
+            }
 
-// 1540458114526859912 diff 1000486554
+            if( fds[1].revents & POLLIN )
+            {
+                break;
+            }
+
+            if( (fds[0].revents & POLLIN) &&
+                read(pData->linefd, &event, sizeof(event)) > 0 )
+            {
+                recorderWrite( pData->pin, &event );
 
-fprintf(stdout, "Event ");
-                if( event.id & pData->eventFlags )
+                pthread_mutex_lock( &pData->lock );
+                dispatchEvent( pData, &event );
+                pthread_mutex_unlock( &pData->lock );
+            }
+            else
+            {
+                if( fds[0].revents & (POLLERR | POLLHUP | POLLNVAL) )
                 {
-fprintf(stdout, " MATCH ");
-                    if( pData->callBack != NULL )
-                    {
-fprintf(stdout, "  ... calling handler\n");
-                       pData->callBack( pData->pin, &event, pData->pUserData );
-                    }
-                    else
-                    {
-fprintf(stdout, " ... BUT NULL handler\n");
-                    }
+                    break;
                 }
             }
         }
@@ -389,6 +581,66 @@ fprintf(stdout, " ... BUT NULL handler\n");
 }
 
 
+// **************************************************************************
+// static int handlerStop( int mapEntry )
+// -----------------------------------------------------------------
+//
+// wake up the event thread of a handler, wait for its termination
+// and return the handler record to the pool
+//
+// -----------------------------------------------------------------
+//
+// int mapEntry   index of the pin in the map table
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+static int handlerStop( int mapEntry )
+{
+    int retVal = 0;
+    struct _event_thread_arg* pArgs;
+
+    if( (pArgs = _p1[mapEntry].pArgs) == NULL )
+    {
+        retVal = DSGPIO_ERROR_NO_HANDLER;
+    }
+    else
+    {
+        // a callback can't wait for its own thread and a replayed
+        // callback can't take the lock the replay already holds
+        if( pthread_equal( pthread_self(), pArgs->thread ) ||
+            (__atomic_load_n( &pArgs->replaying, __ATOMIC_ACQUIRE ) &&
+             pthread_equal( pthread_self(), pArgs->replayer )) )
+        {
+            retVal = DSGPIO_ERROR_GPIO_ACTION;
+        }
+        else
+        {
+            eventfd_write( pArgs->wakefd, 1 );
+            pthread_join( pArgs->thread, NULL );
+
+            close( pArgs->wakefd );
+
+            // the replay driver may still use the record
+            pthread_mutex_lock( &pArgs->lock );
+            pArgs->eventFlags = 0;
+            pArgs->linefd = -1;
+            pArgs->wakefd = -1;
+            pArgs->callBack = NULL;
+            pArgs->pUserData = NULL;
+            _p1[mapEntry].pArgs = NULL;
+            pthread_mutex_unlock( &pArgs->lock );
+
+            retVal = DSGPIO_ERROR_NO_ERROR;
+        }
+    }
+
+    return(retVal);
+}
+
+
 // **************************************************************************
 // int pinHandler( uint8_t pin, uint8_t action, int event, 
 //                 pinCallback_t cb, void* pData )
@@ -399,6 +651,7 @@ fprintf(stdout, " ... BUT NULL handler\n");
 //
 // NOTE: in case of action is DSGPIO_ACTION_CLEAR_HANDLER, the
 //       specified pin is unlocked, too ...
+//       A handler can't be cleared from inside its own callback.
 // -----------------------------------------------------------------
 //
 // uint8_t pin      bcm no of pin
@@ -419,8 +672,7 @@ fprintf(stdout, " ... BUT NULL handler\n");
 //
 // -----------------------------------------------------------------
 //
-// DSGPIO_ERROR_NO_ERROR, DSGPIO_PIN_STATE_HIGH or DSGPIO_PIN_STATE_LOW
-// on success, otherwise an error code
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
 //
 // **************************************************************************
 int pinHandler( uint8_t pin, uint8_t action, int event, pinCallback_t cb, void* pData )
@@ -428,11 +680,11 @@ int pinHandler( uint8_t pin, uint8_t action, int event, pinCallback_t cb, void*
     int retVal = 0;
     int mapEntry;
     struct gpioevent_request req;
-    struct gpiohandle_data data;
     char *chrdev_name;
     int devfd;
     struct _event_thread_arg* pArgs;
 
+    pthread_once( &_handlerPoolOnce, &handlerPoolInit );
 
     if( (mapEntry = retVal = mapFindBCM( pin )) >= 0 )
     {
@@ -444,67 +696,63 @@ int pinHandler( uint8_t pin, uint8_t action, int event, pinCallback_t cb, void*
                 {
                     if( (devfd = open(chrdev_name, 0)) >= 0 )
                     {
+                        free( chrdev_name );
+
                         req.lineoffset = pin;
                         strcpy(req.consumer_label, DSGPIO_CONSUMER_LABEL);
-    
-                        if( action == DSGPIO_ACTION_SET_HANDLER )
+                        req.eventflags = event;
+                        req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+
+                        if(ioctl(devfd,GPIO_GET_LINEEVENT_IOCTL,&req) < 0)
+                        {
+                            close(devfd);
+                            retVal = DSGPIO_ERROR_REQUEST_LINE_HANDLE;
+                        }
+                        else
                         {
-                            req.eventflags = event;
-                            req.handleflags = GPIOHANDLE_REQUEST_INPUT;
-                            if(ioctl(devfd,GPIO_GET_LINEEVENT_IOCTL,&req) < 0)
+                            close(devfd);
+
+                            pArgs = &_handler[mapEntry];
+                            pArgs->eventFlags = event;
+                            pArgs->linefd = req.fd;
+                            pArgs->pin = pin;
+                            pArgs->callBack = cb;
+                            pArgs->pUserData = pData;
+
+                            if( (pArgs->wakefd = eventfd(0, EFD_CLOEXEC)) < 0 )
                             {
-                                close(devfd);
-                                free( chrdev_name );
-                                retVal = DSGPIO_ERROR_REQUEST_LINE_HANDLE;
+                                close( req.fd );
+                                pArgs->linefd = -1;
+                                retVal = DSGPIO_ERROR_OUT_OF_MEMORY;
                             }
                             else
                             {
-                                close(devfd);
-                                free( chrdev_name );
-
-	                        ioctl(req.fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL,
-                                       &data);
-	                        fprintf(stdout, "Initial line value: %d\n", data.values[0]);
-                                _p1[mapEntry].fd = req.fd;
+                                retVal = pthread_create( &pArgs->thread, NULL, &eventThread, pArgs );
 
-                                if( ( _p1[mapEntry].pCallback = 
-                                    (pthread_t*) malloc(sizeof(pthread_t)) ) == NULL)
+                                if( retVal != 0 )
                                 {
+                                    close( pArgs->wakefd );
+                                    close( req.fd );
+                                    pArgs->wakefd = -1;
+                                    pArgs->linefd = -1;
                                     retVal = DSGPIO_ERROR_OUT_OF_MEMORY;
                                 }
                                 else
                                 {
-                                    memset( (char*) _p1[mapEntry].pCallback, 
-                                                 '\0', sizeof(pthread_t) );
-                                    if( (pArgs = (struct _event_thread_arg*) malloc( 
-                                        sizeof(struct _event_thread_arg))) == NULL )
-                                    {
-                                        retVal = DSGPIO_ERROR_OUT_OF_MEMORY;
-                                    }
-                                    else
-                                    {
-                                        memset( (char*) pArgs, '\0', 
-                                            sizeof(struct _event_thread_arg) );
-
-                                        pArgs->eventFlags = event;
-                                        pArgs->linefd = _p1[mapEntry].fd;
-                                        pArgs->pin = pin;
-                                        pArgs->callBack = cb;
-
-fprintf(stdout, "start thread ...");
-                                        retVal  = pthread_create( _p1[mapEntry].pCallback, NULL, &eventThread, pArgs );
-
-fprintf(stdout, "done. retVal = %d\n", retVal);
-
-                                        retVal = DSGPIO_ERROR_NO_ERROR;
-                                    }
-                                }
+                                    _p1[mapEntry].fd = req.fd;
 
+                                    pthread_mutex_lock( &pArgs->lock );
+                                    _p1[mapEntry].pArgs = pArgs;
+                                    pthread_mutex_unlock( &pArgs->lock );
+
+                                    retVal = DSGPIO_ERROR_NO_ERROR;
+                                }
                             }
                         }
                     }
                     else
                     {
+                        free( chrdev_name );
                         retVal = DSGPIO_ERROR_OPEN_DEVICE;
                     }
                 }
@@ -519,35 +767,371 @@ fprintf(stdout, "done. retVal = %d\n", retVal);
                 {
                     retVal = DSGPIO_ERROR_GPIO_ACTION;
                 }
+                else
+                {
+                    retVal = DSGPIO_ERROR_NO_HANDLER;
+                }
             }
         }
         else
         {
             if( action == DSGPIO_ACTION_CLEAR_HANDLER )
             {
-                pthread_cancel( *_p1[mapEntry].pCallback );
-                pthread_join( *_p1[mapEntry].pCallback, NULL );
+                if( _p1[mapEntry].pArgs == NULL )
+                {
+                    retVal = DSGPIO_ERROR_NO_HANDLER;
+                }
+                else
+                {
+                    // stops the handler, too
+                    retVal = pinRelease( pin );
+                }
+            }
+            else
+            {
+                if( action != DSGPIO_ACTION_SET_HANDLER )
+                {
+                    retVal = DSGPIO_ERROR_GPIO_ACTION;
+                }
+                else
+                {
+                    retVal = DSGPIO_ERROR_HANDLE_IN_USE;
+                }
+            }
+        }
+    }
+
+    return(retVal);
+}
 
-                free( (void*) _p1[mapEntry].pCallback);
-                _p1[mapEntry].pCallback = NULL;
 
-                free( (void*) _p1[mapEntry].pArgs);
-                _p1[mapEntry].pArgs = NULL;
+// **************************************************************************
+// int recorderStart( const char* path, uint32_t records )
+// -----------------------------------------------------------------
+//
+// create a ring file for the specified number of records, map it
+// into memory and start recording the events of all handlers.
+// If more than records events occur, the oldest ones are
+// overwritten
+//
+// -----------------------------------------------------------------
+//
+// const char* path  name of the ring file, an existing file is 
+//                   truncated
+// uint32_t records  capacity of the ring file
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int recorderStart( const char* path, uint32_t records )
+{
+    int retVal = 0;
+    int fd;
+    size_t size;
+    struct _event_log_header* pLog;
+
+    pthread_mutex_lock( &_recorderLock );
+
+    if( __atomic_load_n( &_pRecorder, __ATOMIC_SEQ_CST ) != NULL )
+    {
+        retVal = DSGPIO_ERROR_RECORDER_ACTIVE;
+    }
+    else
+    {
+        if( path == NULL || records == 0 )
+        {
+            retVal = DSGPIO_ERROR_OPEN_RECORD_FILE;
+        }
+        else
+        {
+            size = sizeof(struct _event_log_header) + 
+                   (size_t) records * sizeof(struct _event_record);
 
-                retVal = pinRelease( pin );
+            if( (fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0 )
+            {
+                retVal = DSGPIO_ERROR_OPEN_RECORD_FILE;
             }
             else
             {
-                if( action != DSGPIO_ACTION_SET_HANDLER )
+                if( posix_fallocate(fd, 0, size) != 0 )
                 {
-                    retVal = DSGPIO_ERROR_GPIO_ACTION;
+                    close(fd);
+                    retVal = DSGPIO_ERROR_OPEN_RECORD_FILE;
+                }
+                else
+                {
+                    if( (pLog = (struct _event_log_header*) mmap(NULL, size,
+                                 PROT_READ | PROT_WRITE, MAP_SHARED, 
+                                 fd, 0)) == MAP_FAILED )
+                    {
+                        close(fd);
+                        retVal = DSGPIO_ERROR_MAP_RECORD_FILE;
+                    }
+                    else
+                    {
+                        close(fd);
+
+                        // touch all pages now, so no page fault 
+                        // occurs while recording
+                        memset( (char*) pLog, '\0', size );
+
+                        pLog->magic = DSGPIO_RECORD_MAGIC;
+                        pLog->version = DSGPIO_RECORD_VERSION;
+                        pLog->capacity = records;
+                        pLog->recordSize = sizeof(struct _event_record);
+                        pLog->count = 0;
+
+                        _recorderSize = size;
+                        __atomic_store_n( &_pRecorder, pLog, 
+                                          __ATOMIC_SEQ_CST );
+
+                        retVal = DSGPIO_ERROR_NO_ERROR;
+                    }
                 }
             }
         }
     }
 
+    pthread_mutex_unlock( &_recorderLock );
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// int recorderStop( void )
+// -----------------------------------------------------------------
+//
+// stop recording, flush and unmap the ring file
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int recorderStop( void )
+{
+    int retVal = 0;
+    struct _event_log_header* pLog;
+
+    pthread_mutex_lock( &_recorderLock );
+
+    if( (pLog = __atomic_exchange_n( &_pRecorder, 
+                    (struct _event_log_header*) NULL, 
+                    __ATOMIC_SEQ_CST )) == NULL )
+    {
+        retVal = DSGPIO_ERROR_NO_ERROR;
+    }
+    else
+    {
+        // wait for event threads that are still writing a record
+        while( __atomic_load_n( &_recorderWriters, __ATOMIC_SEQ_CST ) > 0 )
+        {
+            sched_yield();
+        }
+
+        msync( (void*) pLog, _recorderSize, MS_SYNC );
+
+        if( munmap( (void*) pLog, _recorderSize ) < 0 )
+        {
+            retVal = DSGPIO_ERROR_MAP_RECORD_FILE;
+        }
+        else
+        {
+            retVal = DSGPIO_ERROR_NO_ERROR;
+        }
+
+        _recorderSize = 0;
+    }
+
+    pthread_mutex_unlock( &_recorderLock );
+
     return(retVal);
 }
 
 
+// **************************************************************************
+// int recorderReplay( const char* path, int speed, 
+//                     pinCallback_t cb, void* pData )
+// -----------------------------------------------------------------
+//
+// feed the events of a ring file back, oldest first. If cb is 
+// NULL, each event is delivered to the handler installed for its
+// pin, exactly as the event thread would do. The lock of the 
+// handler record is held meanwhile, so the callback never runs
+// concurrently for live and replayed events. Otherwise cb is 
+// called for every recorded event, no hardware is needed then.
+// Slots that were never completely written are skipped. Records
+// older than their predecessor are delivered without delay.
+//
+// NOTE: a replayed callback can't clear its own handler, 
+//       pinRelease()/pinHandler() return DSGPIO_ERROR_GPIO_ACTION
+//       then, just as for a live event.
+//
+// -----------------------------------------------------------------
+//
+// const char* path  name of the ring file
+// int speed         DSGPIO_REPLAY_SPEED_MAX to replay without delay,
+//                   DSGPIO_REPLAY_SPEED_REALTIME to keep the recorded
+//                   timing or a factor to accelerate it
+// pinCallback_t cb  callback for all events or NULL
+// void* pData       pointer to extra user data that will be delivered
+//                   to cb
+//
+// -----------------------------------------------------------------
+//
+// no of replayed events on success, otherwise an error code
+//
+// **************************************************************************
+int recorderReplay( const char* path, int speed, pinCallback_t cb, void* pData )
+{
+    int retVal = 0;
+    int fd;
+    int mapEntry;
+    struct stat st;
+    struct _event_log_header* pLog;
+    struct _event_record* pRecord;
+    struct gpioevent_data event;
+    struct timespec due;
+    uint64_t first, index, lastTimestamp = 0;
+    int64_t delta;
+    bool started = false;
+
+    pthread_once( &_handlerPoolOnce, &handlerPoolInit );
+
+    if( path == NULL || speed < 0 || (fd = open(path, O_RDONLY)) < 0 )
+    {
+        retVal = DSGPIO_ERROR_OPEN_RECORD_FILE;
+    }
+    else
+    {
+        if( fstat(fd, &st) < 0 || 
+            (size_t) st.st_size < sizeof(struct _event_log_header) )
+        {
+            close(fd);
+            retVal = DSGPIO_ERROR_RECORD_FORMAT;
+        }
+        else
+        {
+            if( (pLog = (struct _event_log_header*) mmap(NULL, st.st_size,
+                         PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED )
+            {
+                close(fd);
+                retVal = DSGPIO_ERROR_MAP_RECORD_FILE;
+            }
+            else
+            {
+                close(fd);
+
+                if( pLog->magic != DSGPIO_RECORD_MAGIC ||
+                    pLog->version != DSGPIO_RECORD_VERSION ||
+                    pLog->recordSize != sizeof(struct _event_record) ||
+                    pLog->capacity == 0 ||
+                    (size_t) st.st_size < sizeof(struct _event_log_header) + 
+                       (size_t) pLog->capacity * sizeof(struct _event_record) )
+                {
+                    retVal = DSGPIO_ERROR_RECORD_FORMAT;
+                }
+                else
+                {
+                    if( pLog->count > pLog->capacity )
+                    {
+                        first = pLog->count - pLog->capacity;
+                    }
+                    else
+                    {
+                        first = 0;
+                    }
+
+                    clock_gettime( CLOCK_MONOTONIC, &due );
+
+                    for( index = first; index < pLog->count; index++ )
+                    {
+                        pRecord = (struct _event_record*) (pLog + 1) + 
+                                      (index % pLog->capacity);
+
+                        if( __atomic_load_n( &pRecord->seq, __ATOMIC_ACQUIRE )
+                                != (uint32_t) (index + 1) )
+                        {
+                            // claimed, but not written (completely)
+                            continue;
+                        }
+
+                        if( !started )
+                        {
+                            lastTimestamp = pRecord->timestamp;
+                            started = true;
+                        }
+
+                        if( speed != DSGPIO_REPLAY_SPEED_MAX )
+                        {
+                            // distance to the latest event so far, records
+                            // out of order don't move the time back
+                            delta = (int64_t) (pRecord->timestamp - 
+                                               lastTimestamp);
+
+                            if( delta > 0 )
+                            {
+                                lastTimestamp = pRecord->timestamp;
+                                delta /= speed;
+
+                                due.tv_sec  += delta / 1000000000;
+                                due.tv_nsec += delta % 1000000000;
+                                if( due.tv_nsec >= 1000000000 )
+                                {
+                                    due.tv_sec++;
+                                    due.tv_nsec -= 1000000000;
+                                }
+
+                                while( clock_nanosleep( CLOCK_MONOTONIC, 
+                                         TIMER_ABSTIME, &due, NULL ) == EINTR )
+                                    ;
+                            }
+                        }
+
+                        event.timestamp = pRecord->timestamp;
+                        event.id = pRecord->id;
+
+                        if( cb != NULL )
+                        {
+                            cb( pRecord->pin, &event, pData );
+                        }
+                        else
+                        {
+                            if( (mapEntry = mapFindBCM( pRecord->pin )) >= 0 )
+                            {
+                                pthread_mutex_lock( &_handler[mapEntry].lock );
+                                _handler[mapEntry].replayer = pthread_self();
+                                __atomic_store_n( &_handler[mapEntry].replaying,
+                                                  1, __ATOMIC_RELEASE );
+
+                                if( _p1[mapEntry].pArgs != NULL )
+                                {
+                                    dispatchEvent( _p1[mapEntry].pArgs, 
+                                                   &event );
+                                }
+
+                                __atomic_store_n( &_handler[mapEntry].replaying,
+                                                  0, __ATOMIC_RELEASE );
+                                pthread_mutex_unlock( &_handler[mapEntry].lock );
+                            }
+                        }
+
+                        retVal++;
+                    }
+                }
+
+                munmap( (void*) pLog, st.st_size );
+            }
+        }
+    }
+
+    return(retVal);
+}
 
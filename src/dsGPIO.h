@@ -39,6 +39,10 @@
 #include <sys/types.h>
 #include <linux/gpio.h>
 #include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
 
 
 #ifdef __cplusplus
@@ -61,6 +65,15 @@ using namespace std;
 #define DSGPIO_ERROR_GPIO_ACTION          -10
 #define DSGPIO_ERROR_SET_LINE_VALUES      -11
 #define DSGPIO_ERROR_GET_LINE_VALUES      -12
+#define DSGPIO_ERROR_OPEN_RECORD_FILE     -13
+#define DSGPIO_ERROR_MAP_RECORD_FILE      -14
+#define DSGPIO_ERROR_RECORD_FORMAT        -15
+#define DSGPIO_ERROR_RECORDER_ACTIVE      -16
+#define DSGPIO_ERROR_NO_HANDLER           -17
+#define DSGPIO_ERROR_BROKER_RUNNING       -18
+#define DSGPIO_ERROR_BROKER_CONNECT       -19
+#define DSGPIO_ERROR_BROKER_DOWN          -20
+#define DSGPIO_ERROR_BROKER_BUSY          -21
 
 #define DSGPIO_GPIODEV                     "gpiochip0"
 #define DSGPIO_CONSUMER_LABEL              "dsGPIO"
@@ -79,22 +92,51 @@ using namespace std;
 #define DSGPIO_ACTION_SET_HANDLER          0b00010000
 #define DSGPIO_ACTION_CLEAR_HANDLER        0b00100000
 
+#define DSGPIO_RECORD_MAGIC                0x44535243   // "DSRC"
+#define DSGPIO_RECORD_VERSION              1
+
+#define DSGPIO_REPLAY_SPEED_MAX            0
+#define DSGPIO_REPLAY_SPEED_REALTIME       1
+
 
 typedef void (*pinCallback_t) (uint8_t pin, struct gpioevent_data* event, void* pData);
 
 struct _event_thread_arg {
     int   eventFlags;
     int  linefd;
+    int  wakefd;
     uint8_t  pin;
     pinCallback_t callBack;
     void *pUserData;
+    pthread_t thread;
+    pthread_mutex_t lock;   // held while the callback is running
+    int  replaying;         // lock is held by recorderReplay() ...
+    pthread_t replayer;     // ... in this thread
+};
+
+// one recorded edge - this is what is stored in the ring file
+struct _event_record {
+    uint64_t timestamp;
+    uint32_t id;
+    uint32_t seq;       // record no + 1, written after the data
+    uint8_t  pin;
+    uint8_t  reserved[7];
+};
+
+// header at the beginning of the ring file, followed by
+// capacity * struct _event_record
+struct _event_log_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t recordSize;
+    uint64_t count;     // total no of records ever written
 };
 
 struct _bcm_pin_map {
     int phys;
     uint8_t bcm;
     int fd;
-    pthread_t *pCallback;
     struct _event_thread_arg* pArgs;
 };
 
@@ -103,7 +145,12 @@ struct _bcm_pin_map {
 int pinLock( uint8_t pin, int mode );
 int pinRelease( uint8_t pin );
 int pinState( uint8_t pin, uint8_t action, int state );
+int pinHandle( uint8_t pin );
 int pinHandler( uint8_t pin, uint8_t action, int event, pinCallback_t cb, void* pData );
+int recorderStart( const char* path, uint32_t records );
+int recorderStop( void );
+void recorderWrite( uint8_t pin, struct gpioevent_data* event );
+int recorderReplay( const char* path, int speed, pinCallback_t cb, void* pData );
 
 
 
@@ -0,0 +1,414 @@
+/*
+ ***********************************************************************
+ *
+ *  dsGPIO.hpp - header only C++ layer on top of dsGPIO
+ *
+ *  Copyright (C) 2018 Dreamshader (aka Dirk Schanz)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ***********************************************************************
+ *
+ * Pin numbers and modes are template arguments, so an invalid pin,
+ * a pin used twice in a group or setting an input is rejected by
+ * the compiler. The pin is locked by the constructor and released
+ * by the destructor. Objects can be moved, but not copied, so there
+ * always is exactly one owner of a lock.
+ *
+ * The line handle is cached by the constructor, set()/get() do
+ * nothing but the ioctl and return the error codes of dsGPIO.h.
+ * Only the constructors throw (dsgpio::Error).
+ *
+ * Example:
+ *
+ *     dsgpio::OutputPin<18> led;
+ *     led.set( true );
+ *
+ ***********************************************************************
+ */
+
+#ifndef _DSGPIO_HPP_
+#define _DSGPIO_HPP_
+
+#include "dsGPIO.h"
+
+#include <stdexcept>
+
+
+namespace dsgpio {
+
+
+// ==========================================================================
+// --------------------       compile time checks        --------------------
+// ==========================================================================
+
+// the P1 header carries BCM 0 ... 27
+constexpr bool isP1Pin( uint8_t pin )
+{
+    return( pin <= 27 );
+}
+
+constexpr bool allP1Pins()
+{
+    return( true );
+}
+
+template<typename... Rest>
+constexpr bool allP1Pins( uint8_t pin, Rest... rest )
+{
+    return( isP1Pin( pin ) && allP1Pins( rest... ) );
+}
+
+constexpr bool notIn( uint8_t )
+{
+    return( true );
+}
+
+template<typename... Rest>
+constexpr bool notIn( uint8_t pin, uint8_t first, Rest... rest )
+{
+    return( pin != first && notIn( pin, rest... ) );
+}
+
+constexpr bool allDistinct()
+{
+    return( true );
+}
+
+template<typename... Rest>
+constexpr bool allDistinct( uint8_t pin, Rest... rest )
+{
+    return( notIn( pin, rest... ) && allDistinct( rest... ) );
+}
+
+
+// **************************************************************************
+// class Error
+// -----------------------------------------------------------------
+//
+// thrown by the constructors, code() is the DSGPIO_ERROR_xxx value
+//
+// **************************************************************************
+class Error : public std::runtime_error
+{
+public:
+    explicit Error( int code )
+        : std::runtime_error( "dsGPIO error" ), _code( code )
+    {
+    }
+
+    int code() const
+    {
+        return( _code );
+    }
+
+private:
+    int _code;
+};
+
+
+// **************************************************************************
+// template<uint8_t Pin, int Mode> class Line
+// -----------------------------------------------------------------
+//
+// a single locked GPIO. Use OutputPin<> and InputPin<> below.
+//
+// **************************************************************************
+template<uint8_t Pin, int Mode>
+class Line
+{
+    static_assert( isP1Pin( Pin ), "no such BCM pin on the P1 header" );
+    static_assert( Mode == DSGPIO_PIN_MODE_OUTPUT ||
+                   Mode == DSGPIO_PIN_MODE_INPUT, "invalid GPIO mode" );
+
+public:
+    static constexpr uint8_t pin = Pin;
+    static constexpr int mode = Mode;
+
+    Line() : _fd( -1 )
+    {
+        int retVal;
+
+        if( (retVal = pinLock( Pin, Mode )) < 0 )
+        {
+            throw Error( retVal );
+        }
+
+        _fd = pinHandle( Pin );
+    }
+
+    ~Line()
+    {
+        if( _fd >= 0 )
+        {
+            pinRelease( Pin );
+        }
+    }
+
+    Line( const Line& ) = delete;
+    Line& operator=( const Line& ) = delete;
+
+    Line( Line&& other ) noexcept : _fd( other._fd )
+    {
+        other._fd = -1;
+    }
+
+    Line& operator=( Line&& other ) noexcept
+    {
+        if( this != &other )
+        {
+            if( _fd >= 0 )
+            {
+                pinRelease( Pin );
+            }
+            _fd = other._fd;
+            other._fd = -1;
+        }
+
+        return( *this );
+    }
+
+    // DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+    int set( bool high ) noexcept
+    {
+        static_assert( Mode == DSGPIO_PIN_MODE_OUTPUT,
+                       "set() on an input pin" );
+        struct gpiohandle_data data;
+
+        memset( &data.values, 0, sizeof(data.values) );
+        data.values[0] = high ? 1 : 0;
+
+        if( ioctl( _fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data ) < 0 )
+        {
+            return( DSGPIO_ERROR_SET_LINE_VALUES );
+        }
+
+        return( DSGPIO_ERROR_NO_ERROR );
+    }
+
+    int high() noexcept
+    {
+        return( set( true ) );
+    }
+
+    int low() noexcept
+    {
+        return( set( false ) );
+    }
+
+    // DSGPIO_PIN_STATE_HIGH or DSGPIO_PIN_STATE_LOW on success,
+    // otherwise an error code
+    int get() const noexcept
+    {
+        struct gpiohandle_data data;
+
+        if( ioctl( _fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data ) < 0 )
+        {
+            return( DSGPIO_ERROR_GET_LINE_VALUES );
+        }
+
+        return( data.values[0] > 0 ? DSGPIO_PIN_STATE_HIGH :
+                                     DSGPIO_PIN_STATE_LOW );
+    }
+
+    // false for a moved-from object
+    bool locked() const noexcept
+    {
+        return( _fd >= 0 );
+    }
+
+private:
+    int _fd;
+};
+
+template<uint8_t Pin>
+using OutputPin = Line<Pin, DSGPIO_PIN_MODE_OUTPUT>;
+
+template<uint8_t Pin>
+using InputPin = Line<Pin, DSGPIO_PIN_MODE_INPUT>;
+
+
+// **************************************************************************
+// template<int Mode, uint8_t... Pins> class PinGroup
+// -----------------------------------------------------------------
+//
+// several GPIOs of the same mode, locked and released together.
+// Bit n of a value belongs to the n-th pin of the template
+// argument list.
+//
+// **************************************************************************
+template<int Mode, uint8_t... Pins>
+class PinGroup
+{
+    static_assert( sizeof...(Pins) > 0 && sizeof...(Pins) <= 32,
+                   "a group needs 1 ... 32 pins" );
+    static_assert( allP1Pins( Pins... ), "no such BCM pin on the P1 header" );
+    static_assert( allDistinct( Pins... ), "pin used twice in a group" );
+    static_assert( Mode == DSGPIO_PIN_MODE_OUTPUT ||
+                   Mode == DSGPIO_PIN_MODE_INPUT, "invalid GPIO mode" );
+
+public:
+    static constexpr size_t size = sizeof...(Pins);
+    static constexpr int mode = Mode;
+
+    PinGroup()
+    {
+        static const uint8_t pins[] = { Pins... };
+        size_t i;
+        int retVal;
+
+        for( i = 0; i < size; i++ )
+        {
+            if( (retVal = pinLock( pins[i], Mode )) < 0 )
+            {
+                // give back what is locked already
+                while( i-- > 0 )
+                {
+                    pinRelease( pins[i] );
+                }
+                throw Error( retVal );
+            }
+
+            _fd[i] = pinHandle( pins[i] );
+        }
+    }
+
+    ~PinGroup()
+    {
+        release();
+    }
+
+    PinGroup( const PinGroup& ) = delete;
+    PinGroup& operator=( const PinGroup& ) = delete;
+
+    PinGroup( PinGroup&& other ) noexcept
+    {
+        for( size_t i = 0; i < size; i++ )
+        {
+            _fd[i] = other._fd[i];
+            other._fd[i] = -1;
+        }
+    }
+
+    PinGroup& operator=( PinGroup&& other ) noexcept
+    {
+        if( this != &other )
+        {
+            release();
+            for( size_t i = 0; i < size; i++ )
+            {
+                _fd[i] = other._fd[i];
+                other._fd[i] = -1;
+            }
+        }
+
+        return( *this );
+    }
+
+    // DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+    int set( uint32_t values ) noexcept
+    {
+        static_assert( Mode == DSGPIO_PIN_MODE_OUTPUT,
+                       "set() on an input group" );
+        struct gpiohandle_data data;
+
+        memset( &data.values, 0, sizeof(data.values) );
+
+        for( size_t i = 0; i < size; i++ )
+        {
+            data.values[0] = (values >> i) & 1;
+
+            if( ioctl( _fd[i], GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data ) < 0 )
+            {
+                return( DSGPIO_ERROR_SET_LINE_VALUES );
+            }
+        }
+
+        return( DSGPIO_ERROR_NO_ERROR );
+    }
+
+    // bit mask of the pin states on success, otherwise an error code.
+    // A group of 32 pins can't tell errors from bit 31, use
+    // get( uint32_t& ) then.
+    int get() const noexcept
+    {
+        uint32_t values;
+        int retVal;
+
+        if( (retVal = get( values )) < 0 )
+        {
+            return( retVal );
+        }
+
+        return( (int) values );
+    }
+
+    // DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+    int get( uint32_t& values ) const noexcept
+    {
+        struct gpiohandle_data data;
+
+        values = 0;
+
+        for( size_t i = 0; i < size; i++ )
+        {
+            if( ioctl( _fd[i], GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data ) < 0 )
+            {
+                return( DSGPIO_ERROR_GET_LINE_VALUES );
+            }
+
+            if( data.values[0] > 0 )
+            {
+                values |= (uint32_t) 1 << i;
+            }
+        }
+
+        return( DSGPIO_ERROR_NO_ERROR );
+    }
+
+    // false for a moved-from object
+    bool locked() const noexcept
+    {
+        return( _fd[0] >= 0 );
+    }
+
+private:
+    void release() noexcept
+    {
+        static const uint8_t pins[] = { Pins... };
+
+        for( size_t i = 0; i < size; i++ )
+        {
+            if( _fd[i] >= 0 )
+            {
+                pinRelease( pins[i] );
+                _fd[i] = -1;
+            }
+        }
+    }
+
+    int _fd[sizeof...(Pins)];
+};
+
+template<uint8_t... Pins>
+using OutputGroup = PinGroup<DSGPIO_PIN_MODE_OUTPUT, Pins...>;
+
+template<uint8_t... Pins>
+using InputGroup = PinGroup<DSGPIO_PIN_MODE_INPUT, Pins...>;
+
+
+} // namespace dsgpio
+
+
+#endif // _DSGPIO_HPP_
+
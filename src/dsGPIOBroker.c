@@ -0,0 +1,1369 @@
+/*
+ ***********************************************************************
+ *
+ *  dsGPIOBroker.c - shared GPIO access of several local processes
+ *
+ *  Copyright (C) 2018 Dreamshader (aka Dirk Schanz)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ***********************************************************************
+ *
+ * The command queue is a bounded MPSC ring: clients claim a slot by
+ * a CAS on tail and publish their mailbox no in it, the broker is 
+ * the only consumer. The command itself and its result stay in the
+ * mailbox, so the broker gives a slot back as soon as it has read
+ * it. A client that dies can't block the queue: a published slot
+ * is consumed anyway, a claimed but unpublished slot is skipped
+ * after DSGPIO_BROKER_STALL ms. The pins and the mailbox of a dead
+ * client are released by the broker.
+ *
+ ***********************************************************************
+ */
+
+#include "dsGPIOBroker.h"
+
+
+// ==========================================================================
+// --------------------         broker/client state      --------------------
+// ==========================================================================
+
+    // segment as created by brokerStart()
+    static struct _broker_shm* _pServer = NULL;
+    // segment as mapped by brokerConnect()
+    static struct _broker_shm* _pClient = NULL;
+    // mailbox of this process and the lock of its threads
+    static int _clientNo = 0;
+    static pthread_mutex_t _clientLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// **************************************************************************
+// static int futexWait( uint32_t* pWord, uint32_t value, int timeout )
+// -----------------------------------------------------------------
+//
+// sleep as long as *pWord equals value. The futex is not private,
+// so it works across processes that share the segment
+//
+// -----------------------------------------------------------------
+//
+// uint32_t* pWord  futex word
+// uint32_t value   expected value
+// int timeout      timeout in ms, infinite if < 0
+//
+// -----------------------------------------------------------------
+//
+// 0 if woken up or *pWord differs, otherwise -1 (errno is set)
+//
+// **************************************************************************
+static int futexWait( uint32_t* pWord, uint32_t value, int timeout )
+{
+    struct timespec ts;
+
+    if( timeout >= 0 )
+    {
+        ts.tv_sec  = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+    }
+
+    if( syscall( SYS_futex, pWord, FUTEX_WAIT, value,
+                 timeout >= 0 ? &ts : NULL, NULL, 0 ) < 0 &&
+        errno != EAGAIN )
+    {
+        return( -1 );
+    }
+
+    return( 0 );
+}
+
+
+// **************************************************************************
+// static void futexWake( uint32_t* pWord, int count )
+// -----------------------------------------------------------------
+//
+// wake up processes sleeping on a futex word
+//
+// -----------------------------------------------------------------
+//
+// uint32_t* pWord  futex word
+// int count        max no of processes to wake up
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+static void futexWake( uint32_t* pWord, int count )
+{
+    syscall( SYS_futex, pWord, FUTEX_WAKE, count, NULL, NULL, 0 );
+}
+
+
+// **************************************************************************
+// static void brokerEvent( uint8_t pin, struct gpioevent_data* event,
+//                          void* pData )
+// -----------------------------------------------------------------
+//
+// event handler of watched pins. Publishes the event in the
+// segment and wakes up clients waiting in brokerPinWait()
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin                  bcm no of pin
+// struct gpioevent_data* event event data
+// void* pData                  pin entry in the segment
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+static void brokerEvent( uint8_t pin, struct gpioevent_data* event, void* pData )
+{
+    struct _broker_pin* pPin = (struct _broker_pin*) pData;
+
+    if( event->id == GPIOEVENT_EVENT_RISING_EDGE )
+    {
+        __atomic_add_fetch( &pPin->rising, 1, __ATOMIC_RELAXED );
+        __atomic_store_n( &pPin->state, DSGPIO_PIN_STATE_HIGH,
+                          __ATOMIC_RELAXED );
+    }
+    else
+    {
+        __atomic_add_fetch( &pPin->falling, 1, __ATOMIC_RELAXED );
+        __atomic_store_n( &pPin->state, DSGPIO_PIN_STATE_LOW,
+                          __ATOMIC_RELAXED );
+    }
+
+    __atomic_store_n( &pPin->timestamp, event->timestamp, __ATOMIC_RELAXED );
+    __atomic_add_fetch( &pPin->events, 1, __ATOMIC_SEQ_CST );
+
+    if( __atomic_load_n( &pPin->waiters, __ATOMIC_SEQ_CST ) > 0 )
+    {
+        futexWake( &pPin->events, INT_MAX );
+    }
+}
+
+
+// **************************************************************************
+// static int brokerFreeLine( uint8_t pin )
+// -----------------------------------------------------------------
+//
+// give the line of a pin back, no matter who holds it
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin    bcm no of pin
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+static int brokerFreeLine( uint8_t pin )
+{
+    int retVal = 0;
+    struct _broker_pin* pPin = &_pServer->pins[pin];
+
+    if( pPin->watched )
+    {
+        retVal = pinHandler( pin, DSGPIO_ACTION_CLEAR_HANDLER,
+                             0, NULL, NULL );
+    }
+    else
+    {
+        retVal = pinRelease( pin );
+    }
+
+    pPin->holders = 0;
+    pPin->users = 0;
+    pPin->watched = 0;
+    pPin->mode = 0;
+    pPin->state = DSGPIO_PIN_STATE_NO_STATE;
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// static int brokerUnlock( uint8_t pin, int client )
+// -----------------------------------------------------------------
+//
+// drop a client from the holders of a pin and give the line back,
+// if it was the last one
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin    bcm no of pin
+// int client     mailbox no of the client
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+static int brokerUnlock( uint8_t pin, int client )
+{
+    int retVal = 0;
+    struct _broker_pin* pPin = &_pServer->pins[pin];
+
+    if( !(pPin->holders & (1U << client)) )
+    {
+        retVal = DSGPIO_ERROR_PIN_NOT_LOCKED;
+    }
+    else
+    {
+        pPin->holders &= ~(1U << client);
+        pPin->users--;
+
+        if( pPin->holders == 0 )
+        {
+            retVal = brokerFreeLine( pin );
+        }
+        else
+        {
+            retVal = DSGPIO_ERROR_NO_ERROR;
+        }
+    }
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// static void brokerUnlockAll( int client )
+// -----------------------------------------------------------------
+//
+// drop a client from the holders of all pins
+//
+// -----------------------------------------------------------------
+//
+// int client     mailbox no of the client
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+static void brokerUnlockAll( int client )
+{
+    int i;
+
+    for( i = 0; i < DSGPIO_BROKER_MAX_BCM; i++ )
+    {
+        if( _pServer->pins[i].holders & (1U << client) )
+        {
+            brokerUnlock( i, client );
+        }
+    }
+}
+
+
+// **************************************************************************
+// static void brokerReap( void )
+// -----------------------------------------------------------------
+//
+// release the pins and mailboxes of clients that died without
+// brokerDisconnect(). A pending command of such a client is 
+// dropped.
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+static void brokerReap( void )
+{
+    struct _broker_client* pClient;
+    pid_t pid;
+    int i;
+
+    for( i = 0; i < DSGPIO_BROKER_MAX_CLIENTS; i++ )
+    {
+        pClient = &_pServer->clients[i];
+
+        if( (pid = __atomic_load_n( &pClient->pid, __ATOMIC_ACQUIRE )) != 0 &&
+            kill(pid, 0) < 0 && errno == ESRCH )
+        {
+            brokerUnlockAll( i );
+            __atomic_store_n( &pClient->done, 
+                __atomic_load_n( &pClient->request, __ATOMIC_ACQUIRE ),
+                __ATOMIC_SEQ_CST );
+            __atomic_store_n( &pClient->pid, 0, __ATOMIC_RELEASE );
+        }
+    }
+}
+
+
+// **************************************************************************
+// static int brokerExecute( int client )
+// -----------------------------------------------------------------
+//
+// execute the command in the mailbox of a client. Several clients
+// may lock or watch the same pin, as long as they use the same 
+// mode. The line is held by the broker until the last of them 
+// releases it. Only a client holding a pin may use or release it.
+//
+// -----------------------------------------------------------------
+//
+// int client     mailbox no of the client
+//
+// -----------------------------------------------------------------
+//
+// result of the command
+//
+// **************************************************************************
+static int brokerExecute( int client )
+{
+    int retVal = 0;
+    struct _broker_client* pClient = &_pServer->clients[client];
+    uint8_t pin = pClient->pin;
+    uint32_t bit = 1U << client;
+    struct _broker_pin* pPin;
+
+    if( pClient->cmd == DSGPIO_BROKER_CMD_DISCONNECT )
+    {
+        brokerUnlockAll( client );
+        return( DSGPIO_ERROR_NO_ERROR );
+    }
+
+    if( pin >= DSGPIO_BROKER_MAX_BCM )
+    {
+        return( DSGPIO_ERROR_NO_SUCH_BCM_PIN );
+    }
+
+    pPin = &_pServer->pins[pin];
+
+    switch( pClient->cmd )
+    {
+        case DSGPIO_BROKER_CMD_LOCK:
+            if( pPin->holders != 0 )
+            {
+                if( !(pPin->holders & bit) &&
+                    pPin->mode == pClient->arg && !pPin->watched )
+                {
+                    pPin->holders |= bit;
+                    pPin->users++;
+                    retVal = DSGPIO_ERROR_NO_ERROR;
+                }
+                else
+                {
+                    retVal = DSGPIO_ERROR_HANDLE_IN_USE;
+                }
+            }
+            else
+            {
+                if( (retVal = pinLock( pin, pClient->arg )) ==
+                        DSGPIO_ERROR_NO_ERROR )
+                {
+                    pPin->mode = pClient->arg;
+                    pPin->holders = bit;
+                    pPin->users = 1;
+                    pPin->state = DSGPIO_PIN_STATE_NO_STATE;
+                }
+            }
+            break;
+        case DSGPIO_BROKER_CMD_RELEASE:
+            retVal = brokerUnlock( pin, client );
+            break;
+        case DSGPIO_BROKER_CMD_STATE:
+            if( !(pPin->holders & bit) )
+            {
+                retVal = DSGPIO_ERROR_PIN_NOT_LOCKED;
+            }
+            else
+            {
+                if( (retVal = pinState( pin, pClient->action, 
+                                        pClient->arg )) >= 0 )
+                {
+                    if( pClient->action == DSGPIO_ACTION_SET_STATE )
+                    {
+                        __atomic_store_n( &pPin->state, pClient->arg,
+                                          __ATOMIC_RELAXED );
+                    }
+                    else
+                    {
+                        __atomic_store_n( &pPin->state, retVal,
+                                          __ATOMIC_RELAXED );
+                    }
+                }
+            }
+            break;
+        case DSGPIO_BROKER_CMD_WATCH:
+            if( pClient->action == DSGPIO_ACTION_SET_HANDLER )
+            {
+                if( pPin->holders != 0 )
+                {
+                    if( !(pPin->holders & bit) && pPin->watched )
+                    {
+                        pPin->holders |= bit;
+                        pPin->users++;
+                        retVal = DSGPIO_ERROR_NO_ERROR;
+                    }
+                    else
+                    {
+                        retVal = DSGPIO_ERROR_HANDLE_IN_USE;
+                    }
+                }
+                else
+                {
+                    if( (retVal = pinHandler( pin, DSGPIO_ACTION_SET_HANDLER,
+                                   pClient->arg, &brokerEvent, pPin )) ==
+                            DSGPIO_ERROR_NO_ERROR )
+                    {
+                        pPin->mode = DSGPIO_PIN_MODE_INPUT;
+                        pPin->holders = bit;
+                        pPin->users = 1;
+                        pPin->watched = 1;
+                        pPin->state = DSGPIO_PIN_STATE_NO_STATE;
+                    }
+                }
+            }
+            else
+            {
+                if( pClient->action == DSGPIO_ACTION_CLEAR_HANDLER )
+                {
+                    if( !pPin->watched || !(pPin->holders & bit) )
+                    {
+                        retVal = DSGPIO_ERROR_NO_HANDLER;
+                    }
+                    else
+                    {
+                        retVal = brokerUnlock( pin, client );
+                    }
+                }
+                else
+                {
+                    retVal = DSGPIO_ERROR_GPIO_ACTION;
+                }
+            }
+            break;
+        default:
+            retVal = DSGPIO_ERROR_GPIO_ACTION;
+            break;
+    }
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// static void brokerProcess( int client )
+// -----------------------------------------------------------------
+//
+// execute the pending command of a client and wake it up. The
+// queue entry only names the mailbox, so an entry that was left
+// over by a dead client does nothing, unless its mailbox holds a
+// new command again.
+//
+// -----------------------------------------------------------------
+//
+// int client     mailbox no of the client
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+static void brokerProcess( int client )
+{
+    struct _broker_client* pClient;
+    uint32_t request;
+
+    if( client >= DSGPIO_BROKER_MAX_CLIENTS )
+    {
+        return;
+    }
+
+    pClient = &_pServer->clients[client];
+    request = __atomic_load_n( &pClient->request, __ATOMIC_ACQUIRE );
+
+    if( request != __atomic_load_n( &pClient->done, __ATOMIC_ACQUIRE ) )
+    {
+        pClient->result = brokerExecute( client );
+        __atomic_store_n( &pClient->done, request, __ATOMIC_SEQ_CST );
+
+        if( __atomic_load_n( &pClient->waiting, __ATOMIC_SEQ_CST ) )
+        {
+            futexWake( &pClient->done, 1 );
+        }
+    }
+}
+
+
+// **************************************************************************
+// int brokerStart( void )
+// -----------------------------------------------------------------
+//
+// create and initialize the shared memory segment. A stale segment
+// of a broker that is not running any more is removed.
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerStart( void )
+{
+    int retVal = 0;
+    int fd;
+    int i;
+    struct stat st;
+    struct _broker_shm* pShm;
+
+    if( _pServer != NULL )
+    {
+        return( DSGPIO_ERROR_BROKER_RUNNING );
+    }
+
+    if( (fd = shm_open(DSGPIO_BROKER_SHM_NAME, O_RDONLY, 0)) >= 0 )
+    {
+        if( fstat(fd, &st) == 0 &&
+            (size_t) st.st_size >= sizeof(struct _broker_shm) &&
+            (pShm = (struct _broker_shm*) mmap(NULL,
+                     sizeof(struct _broker_shm), PROT_READ, MAP_SHARED,
+                     fd, 0)) != MAP_FAILED )
+        {
+            if( pShm->magic == DSGPIO_BROKER_MAGIC && pShm->running &&
+                (kill(pShm->serverPid, 0) == 0 || errno == EPERM) )
+            {
+                retVal = DSGPIO_ERROR_BROKER_RUNNING;
+            }
+
+            munmap( (void*) pShm, sizeof(struct _broker_shm) );
+        }
+
+        close(fd);
+
+        if( retVal != DSGPIO_ERROR_NO_ERROR )
+        {
+            return( retVal );
+        }
+
+        shm_unlink( DSGPIO_BROKER_SHM_NAME );
+    }
+
+    if( (fd = shm_open(DSGPIO_BROKER_SHM_NAME, O_CREAT | O_EXCL | O_RDWR,
+                       0660)) < 0 )
+    {
+        retVal = DSGPIO_ERROR_OPEN_DEVICE;
+    }
+    else
+    {
+        fchmod( fd, 0660 );
+
+        if( ftruncate(fd, sizeof(struct _broker_shm)) < 0 ||
+            (pShm = (struct _broker_shm*) mmap(NULL,
+                     sizeof(struct _broker_shm), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0)) == MAP_FAILED )
+        {
+            close(fd);
+            shm_unlink( DSGPIO_BROKER_SHM_NAME );
+            retVal = DSGPIO_ERROR_OUT_OF_MEMORY;
+        }
+        else
+        {
+            close(fd);
+
+            memset( (char*) pShm, '\0', sizeof(struct _broker_shm) );
+
+            for( i = 0; i < DSGPIO_BROKER_MAX_BCM; i++ )
+            {
+                pShm->pins[i].state = DSGPIO_PIN_STATE_NO_STATE;
+            }
+
+            for( i = 0; i < DSGPIO_BROKER_QUEUE_SIZE; i++ )
+            {
+                pShm->queue[i] = i;
+            }
+
+            pShm->version = DSGPIO_BROKER_VERSION;
+            pShm->serverPid = getpid();
+            pShm->running = 1;
+
+            // clients check the magic first, so it is set last
+            __atomic_store_n( &pShm->magic, DSGPIO_BROKER_MAGIC,
+                              __ATOMIC_RELEASE );
+
+            _pServer = pShm;
+            retVal = DSGPIO_ERROR_NO_ERROR;
+        }
+    }
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// int brokerServe( void )
+// -----------------------------------------------------------------
+//
+// execute the commands of the queue until brokerShutdown() is
+// called. The broker polls the queue for a while after each
+// command and sleeps on the doorbell futex afterwards. A queue 
+// slot is given back as soon as it is read, so a client can't 
+// block the queue by dying while it waits for its result. A slot
+// that was claimed, but not published for DSGPIO_BROKER_STALL ms
+// is skipped. Clients that died are reaped while the queue is idle.
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerServe( void )
+{
+    struct _broker_shm* pShm;
+    uint64_t* pSlot;
+    uint64_t slot, expected;
+    uint32_t doorbell;
+    struct timespec now, lastReap, stallStart;
+    bool stalled = false;
+    int spin = 0;
+
+    if( (pShm = _pServer) == NULL )
+    {
+        return( DSGPIO_ERROR_BROKER_DOWN );
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &lastReap );
+
+    while( __atomic_load_n( &pShm->running, __ATOMIC_ACQUIRE ) )
+    {
+        // busy or not, dead clients are reaped at a fixed interval
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        if( (now.tv_sec - lastReap.tv_sec) * 1000 +
+            (now.tv_nsec - lastReap.tv_nsec) / 1000000 >=
+                DSGPIO_BROKER_ALIVE_CHECK )
+        {
+            brokerReap();
+            lastReap = now;
+        }
+
+        pSlot = &pShm->queue[pShm->head & (DSGPIO_BROKER_QUEUE_SIZE - 1)];
+        slot = __atomic_load_n( pSlot, __ATOMIC_ACQUIRE );
+
+        if( (slot & DSGPIO_BROKER_SEQ_MASK) == pShm->head + 1 )
+        {
+            __atomic_store_n( pSlot, pShm->head + DSGPIO_BROKER_QUEUE_SIZE,
+                              __ATOMIC_RELEASE );
+            pShm->head++;
+
+            brokerProcess( (int) (slot >> DSGPIO_BROKER_CLIENT_SHIFT) );
+
+            stalled = false;
+            spin = 0;
+            continue;
+        }
+
+        if( slot == pShm->head &&
+            __atomic_load_n( &pShm->tail, __ATOMIC_ACQUIRE ) > pShm->head )
+        {
+            // claimed, but not published yet
+            if( !stalled )
+            {
+                stallStart = now;
+                stalled = true;
+            }
+            else
+            {
+                if( (now.tv_sec - stallStart.tv_sec) * 1000 +
+                    (now.tv_nsec - stallStart.tv_nsec) / 1000000 >=
+                        DSGPIO_BROKER_STALL )
+                {
+                    expected = pShm->head;
+                    if( __atomic_compare_exchange_n( pSlot, &expected,
+                            pShm->head + DSGPIO_BROKER_QUEUE_SIZE, false,
+                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) )
+                    {
+                        pShm->head++;
+                    }
+
+                    stalled = false;
+                    continue;
+                }
+            }
+        }
+
+        if( spin++ >= DSGPIO_BROKER_SPIN )
+        {
+            // announce sleeping first, then check once more. A
+            // client that published a command in between has
+            // bumped the doorbell, so the wait returns at once
+            __atomic_store_n( &pShm->sleeping, 1, __ATOMIC_SEQ_CST );
+            doorbell = __atomic_load_n( &pShm->doorbell, __ATOMIC_SEQ_CST );
+
+            if( (__atomic_load_n( pSlot, __ATOMIC_SEQ_CST ) &
+                    DSGPIO_BROKER_SEQ_MASK) != pShm->head + 1 )
+            {
+                futexWait( &pShm->doorbell, doorbell, 
+                           DSGPIO_BROKER_ALIVE_CHECK );
+            }
+
+            __atomic_store_n( &pShm->sleeping, 0, __ATOMIC_SEQ_CST );
+            spin = 0;
+        }
+    }
+
+    return( DSGPIO_ERROR_NO_ERROR );
+}
+
+
+// **************************************************************************
+// void brokerShutdown( void )
+// -----------------------------------------------------------------
+//
+// make brokerServe() return. May be called from a signal handler.
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// returns nothing
+//
+// **************************************************************************
+void brokerShutdown( void )
+{
+    if( _pServer != NULL )
+    {
+        __atomic_store_n( &_pServer->running, 0, __ATOMIC_SEQ_CST );
+        __atomic_add_fetch( &_pServer->doorbell, 1, __ATOMIC_SEQ_CST );
+        futexWake( &_pServer->doorbell, INT_MAX );
+    }
+}
+
+
+// **************************************************************************
+// int brokerStop( void )
+// -----------------------------------------------------------------
+//
+// release all pins still held by the broker and remove the
+// shared memory segment
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerStop( void )
+{
+    int i;
+
+    if( _pServer == NULL )
+    {
+        return( DSGPIO_ERROR_BROKER_DOWN );
+    }
+
+    __atomic_store_n( &_pServer->running, 0, __ATOMIC_SEQ_CST );
+
+    for( i = 0; i < DSGPIO_BROKER_MAX_BCM; i++ )
+    {
+        if( _pServer->pins[i].holders != 0 )
+        {
+            brokerFreeLine( i );
+        }
+
+        // let clients in brokerPinWait() see that the broker is gone
+        __atomic_add_fetch( &_pServer->pins[i].events, 1, __ATOMIC_SEQ_CST );
+        futexWake( &_pServer->pins[i].events, INT_MAX );
+    }
+
+    shm_unlink( DSGPIO_BROKER_SHM_NAME );
+    munmap( (void*) _pServer, sizeof(struct _broker_shm) );
+    _pServer = NULL;
+
+    return( DSGPIO_ERROR_NO_ERROR );
+}
+
+
+// **************************************************************************
+// static bool brokerAlive( struct _broker_shm* pShm )
+// -----------------------------------------------------------------
+//
+// check, if the broker of a segment is still running
+//
+// -----------------------------------------------------------------
+//
+// struct _broker_shm* pShm  mapped segment
+//
+// -----------------------------------------------------------------
+//
+// true if the broker is running, otherwise false
+//
+// **************************************************************************
+static bool brokerAlive( struct _broker_shm* pShm )
+{
+    if( !__atomic_load_n( &pShm->running, __ATOMIC_ACQUIRE ) ||
+        (kill(pShm->serverPid, 0) < 0 && errno == ESRCH) )
+    {
+        return( false );
+    }
+
+    return( true );
+}
+
+
+// **************************************************************************
+// static int brokerSubmit( uint8_t cmd, uint8_t pin, uint8_t action,
+//                          int arg )
+// -----------------------------------------------------------------
+//
+// write a command into the mailbox, put the mailbox no into the
+// queue and wait for the result. The client polls its mailbox for
+// a while and sleeps on the mailbox futex then. Threads of a 
+// process share the mailbox, so only one command is pending at a
+// time.
+//
+// -----------------------------------------------------------------
+//
+// uint8_t cmd      DSGPIO_BROKER_CMD_xxx
+// uint8_t pin      bcm no of pin
+// uint8_t action   DSGPIO_ACTION_xxx, depending on cmd
+// int arg          mode, state or event, depending on cmd
+//
+// -----------------------------------------------------------------
+//
+// result of the command, otherwise an error code
+//
+// **************************************************************************
+static int brokerSubmit( uint8_t cmd, uint8_t pin, uint8_t action, int arg )
+{
+    int retVal = 0;
+    struct _broker_shm* pShm;
+    struct _broker_client* pClient;
+    uint64_t* pSlot;
+    uint64_t pos, slot, expected;
+    uint32_t request, done;
+    struct timespec now, start;
+    bool waited = false;
+    int spin;
+
+    if( (pShm = _pClient) == NULL )
+    {
+        return( DSGPIO_ERROR_BROKER_CONNECT );
+    }
+
+    if( pin >= DSGPIO_BROKER_MAX_BCM )
+    {
+        return( DSGPIO_ERROR_NO_SUCH_BCM_PIN );
+    }
+
+    if( !__atomic_load_n( &pShm->running, __ATOMIC_ACQUIRE ) )
+    {
+        return( DSGPIO_ERROR_BROKER_DOWN );
+    }
+
+    pthread_mutex_lock( &_clientLock );
+
+    pClient = &pShm->clients[_clientNo];
+    pClient->cmd = cmd;
+    pClient->pin = pin;
+    pClient->action = action;
+    pClient->arg = arg;
+    pClient->waiting = 0;
+    request = pClient->request + 1;
+    __atomic_store_n( &pClient->request, request, __ATOMIC_RELEASE );
+
+    pos = __atomic_load_n( &pShm->tail, __ATOMIC_RELAXED );
+
+    while( 1 )
+    {
+        pSlot = &pShm->queue[pos & (DSGPIO_BROKER_QUEUE_SIZE - 1)];
+        slot = __atomic_load_n( pSlot, __ATOMIC_ACQUIRE );
+
+        if( slot == pos )
+        {
+            if( __atomic_compare_exchange_n( &pShm->tail, &pos, pos + 1,
+                    true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            {
+                // publishing fails only, if the broker has skipped
+                // the slot, because we stalled too long
+                expected = pos;
+                if( __atomic_compare_exchange_n( pSlot, &expected,
+                        (pos + 1) | ((uint64_t) _clientNo << 
+                                     DSGPIO_BROKER_CLIENT_SHIFT),
+                        false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) )
+                {
+                    break;
+                }
+
+                pos = __atomic_load_n( &pShm->tail, __ATOMIC_RELAXED );
+            }
+        }
+        else
+        {
+            if( (int64_t) ((slot & DSGPIO_BROKER_SEQ_MASK) - pos) < 0 )
+            {
+                // queue is full
+                clock_gettime( CLOCK_MONOTONIC, &now );
+                if( !waited )
+                {
+                    start = now;
+                    waited = true;
+                }
+
+                if( !brokerAlive( pShm ) )
+                {
+                    retVal = DSGPIO_ERROR_BROKER_DOWN;
+                }
+                else
+                {
+                    if( (now.tv_sec - start.tv_sec) * 1000 +
+                        (now.tv_nsec - start.tv_nsec) / 1000000 >=
+                            DSGPIO_BROKER_TIMEOUT )
+                    {
+                        retVal = DSGPIO_ERROR_BROKER_BUSY;
+                    }
+                }
+
+                if( retVal != DSGPIO_ERROR_NO_ERROR )
+                {
+                    // withdraw the command
+                    __atomic_store_n( &pClient->request, request - 1,
+                                      __ATOMIC_RELEASE );
+                    pthread_mutex_unlock( &_clientLock );
+                    return( retVal );
+                }
+
+                sched_yield();
+            }
+
+            pos = __atomic_load_n( &pShm->tail, __ATOMIC_RELAXED );
+        }
+    }
+
+    __atomic_add_fetch( &pShm->doorbell, 1, __ATOMIC_SEQ_CST );
+
+    if( __atomic_load_n( &pShm->sleeping, __ATOMIC_SEQ_CST ) )
+    {
+        futexWake( &pShm->doorbell, 1 );
+    }
+
+    for( spin = 0; spin < DSGPIO_BROKER_SPIN &&
+                   __atomic_load_n( &pClient->done, __ATOMIC_ACQUIRE ) !=
+                       request; spin++ )
+        ;
+
+    while( (done = __atomic_load_n( &pClient->done, __ATOMIC_ACQUIRE )) !=
+               request )
+    {
+        if( !brokerAlive( pShm ) )
+        {
+            pthread_mutex_unlock( &_clientLock );
+            return( DSGPIO_ERROR_BROKER_DOWN );
+        }
+
+        __atomic_store_n( &pClient->waiting, 1, __ATOMIC_SEQ_CST );
+        futexWait( &pClient->done, done, DSGPIO_BROKER_ALIVE_CHECK );
+    }
+
+    retVal = pClient->result;
+
+    pthread_mutex_unlock( &_clientLock );
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// int brokerConnect( void )
+// -----------------------------------------------------------------
+//
+// map the shared memory segment of a running broker and take a
+// free mailbox
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerConnect( void )
+{
+    int retVal = 0;
+    int fd;
+    int i;
+    pid_t freePid;
+    struct stat st;
+    struct _broker_shm* pShm;
+
+    if( _pClient != NULL )
+    {
+        return( DSGPIO_ERROR_NO_ERROR );
+    }
+
+    if( (fd = shm_open(DSGPIO_BROKER_SHM_NAME, O_RDWR, 0)) < 0 )
+    {
+        retVal = DSGPIO_ERROR_BROKER_CONNECT;
+    }
+    else
+    {
+        if( fstat(fd, &st) < 0 ||
+            (size_t) st.st_size < sizeof(struct _broker_shm) ||
+            (pShm = (struct _broker_shm*) mmap(NULL,
+                     sizeof(struct _broker_shm), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0)) == MAP_FAILED )
+        {
+            retVal = DSGPIO_ERROR_BROKER_CONNECT;
+        }
+        else
+        {
+            if( __atomic_load_n( &pShm->magic, __ATOMIC_ACQUIRE ) !=
+                    DSGPIO_BROKER_MAGIC ||
+                pShm->version != DSGPIO_BROKER_VERSION )
+            {
+                munmap( (void*) pShm, sizeof(struct _broker_shm) );
+                retVal = DSGPIO_ERROR_BROKER_CONNECT;
+            }
+            else
+            {
+                if( !__atomic_load_n( &pShm->running, __ATOMIC_ACQUIRE ) )
+                {
+                    munmap( (void*) pShm, sizeof(struct _broker_shm) );
+                    retVal = DSGPIO_ERROR_BROKER_DOWN;
+                }
+                else
+                {
+                    for( i = 0; i < DSGPIO_BROKER_MAX_CLIENTS; i++ )
+                    {
+                        freePid = 0;
+                        if( __atomic_compare_exchange_n( 
+                                &pShm->clients[i].pid, &freePid, getpid(),
+                                false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) )
+                        {
+                            break;
+                        }
+                    }
+
+                    if( i < DSGPIO_BROKER_MAX_CLIENTS )
+                    {
+                        _clientNo = i;
+                        _pClient = pShm;
+                        retVal = DSGPIO_ERROR_NO_ERROR;
+                    }
+                    else
+                    {
+                        // all mailboxes in use
+                        munmap( (void*) pShm, sizeof(struct _broker_shm) );
+                        retVal = DSGPIO_ERROR_BROKER_BUSY;
+                    }
+                }
+            }
+        }
+
+        close(fd);
+    }
+
+    return(retVal);
+}
+
+
+
+
+
+// **************************************************************************
+// int brokerDisconnect( void )
+// -----------------------------------------------------------------
+//
+// release all pins held by this process, give the mailbox back and 
+// unmap the shared memory segment. If the broker can't be reached,
+// the mailbox is left to the broker, which frees it and the pins
+// after this process has terminated.
+//
+// -----------------------------------------------------------------
+//
+// no arguments
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerDisconnect( void )
+{
+    int retVal = 0;
+
+    if( _pClient == NULL )
+    {
+        return( DSGPIO_ERROR_BROKER_CONNECT );
+    }
+
+    if( (retVal = brokerSubmit( DSGPIO_BROKER_CMD_DISCONNECT, 0, 0, 0 )) >= 0 ||
+        retVal == DSGPIO_ERROR_BROKER_DOWN )
+    {
+        // a restarted broker starts with all pins unlocked
+        __atomic_store_n( &_pClient->clients[_clientNo].pid, 0, 
+                          __ATOMIC_RELEASE );
+        retVal = DSGPIO_ERROR_NO_ERROR;
+    }
+    // otherwise the pins are still held in the name of this mailbox.
+    // Keep the pid, the broker reaps the mailbox when we are gone.
+
+    munmap( (void*) _pClient, sizeof(struct _broker_shm) );
+    _pClient = NULL;
+
+    return(retVal);
+}
+
+
+// **************************************************************************
+// int brokerPinLock( uint8_t pin, int mode )
+// -----------------------------------------------------------------
+//
+// same as pinLock(), but the line is held by the broker
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin    bcm no of pin
+// int    mode    either INPUT or OUTPUT
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerPinLock( uint8_t pin, int mode )
+{
+    return( brokerSubmit( DSGPIO_BROKER_CMD_LOCK, pin, 0, mode ) );
+}
+
+
+// **************************************************************************
+// int brokerPinRelease( uint8_t pin )
+// -----------------------------------------------------------------
+//
+// same as pinRelease(). The broker gives the line back, when the
+// last process has released it. Only a process that has locked
+// the pin may release it.
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin    bcm no of pin
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerPinRelease( uint8_t pin )
+{
+    return( brokerSubmit( DSGPIO_BROKER_CMD_RELEASE, pin, 0, 0 ) );
+}
+
+
+// **************************************************************************
+// int brokerPinState( uint8_t pin, uint8_t action, int state )
+// -----------------------------------------------------------------
+//
+// same as pinState()
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin    bcm no of pin
+// uint8_t action either DSGPIO_ACTION_SET_STATE or DSGPIO_ACTION_GET_STATE
+// int state      either DSGPIO_PIN_STATE_HIGH or DSGPIO_PIN_STATE_LOW
+//                is ignored, if action is DSGPIO_ACTION_GET_STATE
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR, DSGPIO_PIN_STATE_HIGH or DSGPIO_PIN_STATE_LOW
+// on success, otherwise an error code
+//
+// **************************************************************************
+int brokerPinState( uint8_t pin, uint8_t action, int state )
+{
+    return( brokerSubmit( DSGPIO_BROKER_CMD_STATE, pin, action, state ) );
+}
+
+
+// **************************************************************************
+// int brokerPinWatch( uint8_t pin, uint8_t action, int event )
+// -----------------------------------------------------------------
+//
+// let the broker install/clear an event handler on the given pin.
+// The broker counts the events in the segment, use brokerPinInfo()
+// and brokerPinWait() to get them.
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin      bcm no of pin
+// uint8_t action   either DSGPIO_ACTION_SET_HANDLER or
+//                         DSGPIO_ACTION_CLEAR_HANDLER
+// int event        GPIOEVENT_EVENT_RISING_EDGE,
+//                  GPIOEVENT_EVENT_FALLING_EDGE or a combination
+//                  of both
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerPinWatch( uint8_t pin, uint8_t action, int event )
+{
+    return( brokerSubmit( DSGPIO_BROKER_CMD_WATCH, pin, action, event ) );
+}
+
+
+// **************************************************************************
+// int brokerPinInfo( uint8_t pin, struct _broker_pin* pInfo )
+// -----------------------------------------------------------------
+//
+// copy the published state of a pin. This is read directly from
+// the segment, no command is sent to the broker.
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin                bcm no of pin
+// struct _broker_pin* pInfo  receives the state
+//
+// -----------------------------------------------------------------
+//
+// DSGPIO_ERROR_NO_ERROR on success, otherwise an error code
+//
+// **************************************************************************
+int brokerPinInfo( uint8_t pin, struct _broker_pin* pInfo )
+{
+    if( _pClient == NULL )
+    {
+        return( DSGPIO_ERROR_BROKER_CONNECT );
+    }
+
+    if( pin >= DSGPIO_BROKER_MAX_BCM || pInfo == NULL )
+    {
+        return( DSGPIO_ERROR_NO_SUCH_BCM_PIN );
+    }
+
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    memcpy( (char*) pInfo, (char*) &_pClient->pins[pin],
+            sizeof(struct _broker_pin) );
+
+    return( DSGPIO_ERROR_NO_ERROR );
+}
+
+
+// **************************************************************************
+// int brokerPinWait( uint8_t pin, uint32_t* pSeen, int timeout )
+// -----------------------------------------------------------------
+//
+// wait for events on a watched pin. Returns at once, if the event
+// counter differs from *pSeen, otherwise sleeps on the counter.
+// Returns DSGPIO_ERROR_BROKER_DOWN, if the broker stops or dies
+// meanwhile.
+//
+// -----------------------------------------------------------------
+//
+// uint8_t pin      bcm no of pin
+// uint32_t* pSeen  event counter seen so far, is updated
+// int timeout      timeout in ms, infinite if < 0
+//
+// -----------------------------------------------------------------
+//
+// no of new events (0 on timeout), otherwise an error code
+//
+// **************************************************************************
+int brokerPinWait( uint8_t pin, uint32_t* pSeen, int timeout )
+{
+    int retVal = 0;
+    struct _broker_pin* pPin;
+    uint32_t events;
+    struct timespec now, deadline;
+    int slice;
+
+    if( _pClient == NULL )
+    {
+        return( DSGPIO_ERROR_BROKER_CONNECT );
+    }
+
+    if( pin >= DSGPIO_BROKER_MAX_BCM || pSeen == NULL )
+    {
+        return( DSGPIO_ERROR_NO_SUCH_BCM_PIN );
+    }
+
+    pPin = &_pClient->pins[pin];
+
+    clock_gettime( CLOCK_MONOTONIC, &deadline );
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000;
+
+    // sleep in slices, so a broker that has died is noticed
+    while( __atomic_load_n( &pPin->events, __ATOMIC_SEQ_CST ) == *pSeen )
+    {
+        if( !brokerAlive( _pClient ) )
+        {
+            return( DSGPIO_ERROR_BROKER_DOWN );
+        }
+
+        slice = DSGPIO_BROKER_ALIVE_CHECK;
+
+        if( timeout >= 0 )
+        {
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            if( (deadline.tv_sec - now.tv_sec) * 1000 +
+                (deadline.tv_nsec - now.tv_nsec) / 1000000 < slice )
+            {
+                slice = (deadline.tv_sec - now.tv_sec) * 1000 +
+                        (deadline.tv_nsec - now.tv_nsec) / 1000000;
+            }
+
+            if( slice <= 0 )
+            {
+                break;
+            }
+        }
+
+        __atomic_add_fetch( &pPin->waiters, 1, __ATOMIC_SEQ_CST );
+        futexWait( &pPin->events, *pSeen, slice );
+        __atomic_sub_fetch( &pPin->waiters, 1, __ATOMIC_SEQ_CST );
+    }
+
+    if( !__atomic_load_n( &_pClient->running, __ATOMIC_ACQUIRE ) )
+    {
+        return( DSGPIO_ERROR_BROKER_DOWN );
+    }
+
+    events = __atomic_load_n( &pPin->events, __ATOMIC_ACQUIRE );
+
+    if( events - *pSeen > INT_MAX )
+    {
+        retVal = INT_MAX;
+    }
+    else
+    {
+        retVal = events - *pSeen;
+    }
+
+    *pSeen = events;
+
+    return(retVal);
+}
+
@@ -0,0 +1,148 @@
+/*
+ ***********************************************************************
+ *
+ *  dsGPIOBroker.h - definitions/declarations for shared GPIO access
+ *                   of several local processes through a broker
+ *
+ *  Copyright (C) 2018 Dreamshader (aka Dirk Schanz)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ***********************************************************************
+ *
+ * The broker is the only process that requests line handles. It 
+ * creates a shared memory segment that holds the state and event
+ * counters of all pins, a mailbox for each client and a command 
+ * queue. Clients write their command into their mailbox, put the
+ * mailbox no into the queue and wait for the result on a futex in
+ * the mailbox. The broker sleeps on a futex, too, while the queue
+ * is empty.
+ *
+ ***********************************************************************
+ */
+
+#ifndef _DSGPIOBROKER_H_
+#define _DSGPIOBROKER_H_
+
+#include "dsGPIO.h"
+
+#include <signal.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define DSGPIO_BROKER_SHM_NAME             "/dsGPIO"
+#define DSGPIO_BROKER_MAGIC                0x44534252   // "DSBR"
+#define DSGPIO_BROKER_VERSION              1
+
+// no of slots in the command queue, must be a power of 2
+#define DSGPIO_BROKER_QUEUE_SIZE           64
+// highest bcm no + 1 on the P1 header
+#define DSGPIO_BROKER_MAX_BCM              28
+// no of client mailboxes, a client is a bit in _broker_pin.holders
+#define DSGPIO_BROKER_MAX_CLIENTS          32
+// no of polls before a waiting client/the broker sleeps on the futex
+#define DSGPIO_BROKER_SPIN                 2000
+// interval to check, if the broker/the clients are still alive, in ms
+#define DSGPIO_BROKER_ALIVE_CHECK          100
+// time in ms the broker waits for a claimed queue slot to be published
+#define DSGPIO_BROKER_STALL                1000
+// time in ms a client waits for a free queue slot
+#define DSGPIO_BROKER_TIMEOUT              1000
+
+// a published queue slot holds the sequence no in the lower bits
+// and the mailbox no of the client in the upper bits
+#define DSGPIO_BROKER_CLIENT_SHIFT         58
+#define DSGPIO_BROKER_SEQ_MASK             ((1ULL << DSGPIO_BROKER_CLIENT_SHIFT) - 1)
+
+#define DSGPIO_BROKER_CMD_LOCK             1
+#define DSGPIO_BROKER_CMD_RELEASE          2
+#define DSGPIO_BROKER_CMD_STATE            3
+#define DSGPIO_BROKER_CMD_WATCH            4
+#define DSGPIO_BROKER_CMD_DISCONNECT       5
+
+
+// published state of a single pin
+struct _broker_pin {
+    int32_t  mode;      // 0 if unused, else DSGPIO_PIN_MODE_xxx
+    int32_t  state;     // last known DSGPIO_PIN_STATE_xxx
+    int32_t  users;     // no of clients holding the pin
+    uint32_t holders;   // bit n set, if client n holds the pin
+    int32_t  watched;   // an event handler is installed
+    uint32_t events;    // no of events, futex word for brokerPinWait()
+    uint32_t waiters;   // no of clients sleeping on events
+    uint64_t rising;
+    uint64_t falling;
+    uint64_t timestamp; // timestamp of the last event
+};
+
+// mailbox of a single client, holds one command at a time
+struct _broker_client {
+    pid_t    pid;       // 0 if the mailbox is free
+    uint32_t request;   // no of the current command
+    uint32_t done;      // futex word, no of the last executed command
+    uint32_t waiting;   // client is sleeping on done
+    uint8_t  cmd;
+    uint8_t  pin;
+    uint8_t  action;
+    uint8_t  reserved;
+    int32_t  arg;       // mode, state or event, depending on cmd
+    int32_t  result;
+} __attribute__((aligned(64)));
+
+// layout of the shared memory segment
+struct _broker_shm {
+    uint32_t magic;
+    uint32_t version;
+    pid_t    serverPid;
+    uint32_t running;
+    uint32_t doorbell;  // futex word, bumped for every command
+    uint32_t sleeping;  // broker is sleeping on doorbell
+    uint64_t head       __attribute__((aligned(64)));  // broker only
+    uint64_t tail       __attribute__((aligned(64)));  // all clients
+    struct _broker_pin  pins[DSGPIO_BROKER_MAX_BCM] __attribute__((aligned(64)));
+    struct _broker_client clients[DSGPIO_BROKER_MAX_CLIENTS];
+    uint64_t queue[DSGPIO_BROKER_QUEUE_SIZE] __attribute__((aligned(64)));
+};
+
+
+// broker side
+int brokerStart( void );
+int brokerServe( void );
+void brokerShutdown( void );
+int brokerStop( void );
+
+// client side
+int brokerConnect( void );
+int brokerDisconnect( void );
+int brokerPinLock( uint8_t pin, int mode );
+int brokerPinRelease( uint8_t pin );
+int brokerPinState( uint8_t pin, uint8_t action, int state );
+int brokerPinWatch( uint8_t pin, uint8_t action, int event );
+int brokerPinInfo( uint8_t pin, struct _broker_pin* pInfo );
+int brokerPinWait( uint8_t pin, uint32_t* pSeen, int timeout );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif // _DSGPIOBROKER_H_
+
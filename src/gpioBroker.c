@@ -0,0 +1,37 @@
+#include "dsGPIOBroker.h"
+
+// gpioBroker - holds the GPIO lines and executes the commands of
+// local client processes until SIGINT or SIGTERM is received
+
+void stopHandler( int sig )
+{
+    brokerShutdown();
+}
+
+
+int main( int argc, char* argv[] )
+{
+    int exitCode = 0;
+    struct sigaction sa;
+
+    memset( (char*) &sa, '\0', sizeof(sa) );
+    sa.sa_handler = &stopHandler;
+    sigaction( SIGINT, &sa, NULL );
+    sigaction( SIGTERM, &sa, NULL );
+
+    if( (exitCode = brokerStart()) >= 0 )
+    {
+fprintf(stdout, "broker running, pid %d\n", getpid());
+
+        exitCode = brokerServe();
+
+        brokerStop();
+    }
+    else
+    {
+fprintf(stderr, "broker start failed!\n");
+    }
+printf("ends with exitcode %d\n", exitCode);
+    return( exitCode );
+}
+
@@ -0,0 +1,109 @@
+#include "dsGPIOBroker.h"
+
+// gpioBrokerClient - uses the GPIOs through a running gpioBroker
+//
+//   -p pin      bcm no of pin (default 18)
+//   -n rounds   no of GET_STATE round trips to time (default 10000)
+//   -w ms       time to wait for events on the pin (default 1000)
+//
+// Without GPIO hardware the lock fails, the round trips are timed
+// anyway (they return DSGPIO_ERROR_PIN_NOT_LOCKED then).
+
+#define MYPIN    18
+
+int main( int argc, char* argv[] )
+{
+    int exitCode = 0;
+    int opt;
+    int i;
+    int rounds = 10000;
+    int waitTime = 1000;
+    uint8_t pin = MYPIN;
+    uint32_t seen;
+    struct _broker_pin info;
+    struct timespec start, end;
+    double usecs;
+
+    while( (opt = getopt(argc, argv, "p:n:w:")) != -1 )
+    {
+        switch( opt )
+        {
+            case 'p':
+                pin = atoi( optarg );
+                break;
+            case 'n':
+                rounds = atoi( optarg );
+                break;
+            case 'w':
+                waitTime = atoi( optarg );
+                break;
+            default:
+fprintf(stderr, "usage: %s [-p pin] [-n rounds] [-w ms]\n", argv[0]);
+                return( 1 );
+        }
+    }
+
+    if( (exitCode = brokerConnect()) < 0 )
+    {
+fprintf(stderr, "connect failed[%d]!\n", exitCode);
+        return( exitCode );
+    }
+
+    exitCode = brokerPinLock( pin, DSGPIO_PIN_MODE_OUTPUT );
+printf("lock: %d\n", exitCode );
+
+    if( exitCode >= 0 )
+    {
+        exitCode = brokerPinState( pin, DSGPIO_ACTION_SET_STATE, 
+                                   DSGPIO_PIN_STATE_HIGH );
+printf("set state: %d\n", exitCode );
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for( i = 0; i < rounds; i++ )
+    {
+        if( (exitCode = brokerPinState( pin, DSGPIO_ACTION_GET_STATE, 0 )) ==
+                DSGPIO_ERROR_BROKER_DOWN )
+        {
+            break;
+        }
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    usecs = ((end.tv_sec - start.tv_sec) * 1e9 + 
+             (end.tv_nsec - start.tv_nsec)) / 1000.0;
+printf("get state: %d, %d round trips, %.2f us each\n", exitCode, i, 
+       i > 0 ? usecs / i : 0.0 );
+
+    if( exitCode == DSGPIO_ERROR_BROKER_DOWN )
+    {
+fprintf(stderr, "broker is down!\n");
+        brokerDisconnect();
+        return( exitCode );
+    }
+
+    brokerPinRelease( pin );
+
+    exitCode = brokerPinWatch( pin, DSGPIO_ACTION_SET_HANDLER,
+                    GPIOEVENT_REQUEST_RISING_EDGE | 
+                    GPIOEVENT_REQUEST_FALLING_EDGE );
+printf("watch: %d\n", exitCode );
+
+    brokerPinInfo( pin, &info );
+    seen = info.events;
+
+    exitCode = brokerPinWait( pin, &seen, waitTime );
+printf("wait: %d new events\n", exitCode );
+
+    brokerPinInfo( pin, &info );
+printf("pin %d: state %d, %u events (%llu rising, %llu falling)\n", pin,
+       info.state, info.events, (unsigned long long) info.rising,
+       (unsigned long long) info.falling );
+
+    brokerPinWatch( pin, DSGPIO_ACTION_CLEAR_HANDLER, 0 );
+    brokerDisconnect();
+
+printf("ends with exitcode %d\n", exitCode);
+    return( exitCode < 0 ? exitCode : 0 );
+}
+
@@ -0,0 +1,127 @@
+#include "dsGPIO.h"
+
+// gpioReplay - replay a recording of the event recorder
+//
+//   gpioReplay <file> [speed]   replay file, speed 0 = as fast as
+//                               possible, 1 = real time, n = n times
+//                               faster
+//   gpioReplay                  record synthetic events and check
+//                               the replay, no hardware needed
+
+#define RECORD_FILE   "/tmp/gpioReplay.rec"
+#define RECORD_SLOTS  8
+
+struct replayStats {
+    int events;
+    int rising;
+    int falling;
+    bool verbose;
+};
+
+void callBackFunc( uint8_t pin, struct gpioevent_data* event, void* pData )
+{
+    struct replayStats* pStats = (struct replayStats*) pData;
+
+    pStats->events++;
+    if( event->id == GPIOEVENT_EVENT_RISING_EDGE )
+    {
+        pStats->rising++;
+    }
+    else
+    {
+        pStats->falling++;
+    }
+
+    if( pStats->verbose )
+    {
+printf("pin %d id %u timestamp %llu\n", pin, event->id, 
+       (unsigned long long) event->timestamp);
+    }
+}
+
+static double elapsed( struct timespec* pStart )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return( (now.tv_sec - pStart->tv_sec) + 
+            (now.tv_nsec - pStart->tv_nsec) / 1e9 );
+}
+
+int main( int argc, char* argv[] )
+{
+    int exitCode = 0;
+    int i;
+    int speed = DSGPIO_REPLAY_SPEED_MAX;
+    struct replayStats stats;
+    struct gpioevent_data event;
+    struct timespec start;
+    double seconds;
+
+    memset( (char*) &stats, '\0', sizeof(stats) );
+
+    if( argc > 1 )
+    {
+        if( argc > 2 )
+        {
+            speed = atoi( argv[2] );
+        }
+
+        stats.verbose = true;
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        exitCode = recorderReplay( argv[1], speed, &callBackFunc, &stats );
+        seconds = elapsed( &start );
+
+printf("replayed %d events (%d rising, %d falling) in %.6f s\n", 
+       exitCode, stats.rising, stats.falling, seconds);
+        return( exitCode < 0 ? exitCode : 0 );
+    }
+
+    // 12 events into 8 slots, the last one is out of order
+    if( (exitCode = recorderStart( RECORD_FILE, RECORD_SLOTS )) < 0 )
+    {
+fprintf(stderr, "recorder start failed[%d]!\n", exitCode);
+        return( exitCode );
+    }
+
+    for( i = 0; i < 12; i++ )
+    {
+        event.timestamp = 1000000000ULL + i * 1000000ULL;
+        event.id = (i & 1) ? GPIOEVENT_EVENT_FALLING_EDGE :
+                             GPIOEVENT_EVENT_RISING_EDGE;
+        if( i == 11 )
+        {
+            event.timestamp = 1000000000ULL;
+        }
+        recorderWrite( 18, &event );
+    }
+
+    recorderStop();
+
+    exitCode = recorderReplay( RECORD_FILE, DSGPIO_REPLAY_SPEED_MAX, 
+                               &callBackFunc, &stats );
+printf("max speed: %d events\n", exitCode);
+    if( exitCode != RECORD_SLOTS || stats.rising != 4 || stats.falling != 4 )
+    {
+fprintf(stderr, "max speed replay failed!\n");
+        return( 1 );
+    }
+
+    // 6 ms recorded, must take about 6 ms in real time
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    exitCode = recorderReplay( RECORD_FILE, DSGPIO_REPLAY_SPEED_REALTIME,
+                               &callBackFunc, &stats );
+    seconds = elapsed( &start );
+printf("real time: %d events in %.6f s\n", exitCode, seconds);
+    if( exitCode != RECORD_SLOTS || seconds < 0.006 || seconds > 0.5 )
+    {
+fprintf(stderr, "real time replay failed!\n");
+        return( 1 );
+    }
+
+    unlink( RECORD_FILE );
+
+printf("ends with exitcode 0\n");
+    return( 0 );
+}
+
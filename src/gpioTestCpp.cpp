@@ -0,0 +1,37 @@
+#include "dsGPIO.hpp"
+
+#define MYPIN    18
+
+int main( int argc, char* argv[] )
+{
+    int exitCode = 0;
+
+    try
+    {
+        dsgpio::OutputPin<MYPIN> out;
+
+        if( (exitCode = out.high()) >= 0 )
+        {
+            exitCode = out.get();
+printf("get state: %d\n", exitCode );
+        }
+        else
+        {
+fprintf(stderr, "set state failed!\n");
+        }
+
+        dsgpio::OutputGroup<23, 24, 25> group;
+
+        exitCode = group.set( 0b101 );
+printf("group set[%d], get: %d\n", exitCode, group.get() );
+    }
+    catch( const dsgpio::Error& e )
+    {
+fprintf(stderr, "lock failed[%d]!\n", e.code());
+        exitCode = e.code();
+    }
+
+printf("ends with exitcode %d\n", exitCode);
+    return( exitCode );
+}
+